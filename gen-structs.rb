@@ -5,6 +5,53 @@
 # run gen-bboxes.sh first if you need reverse lookup (location -> postcode) support, then:
 # ./gen-structs.rb /path/to/codepoint-open/folder
 
+# to build a regional slice of the data, add either of:
+# --areas=BN,RH,TN  (keep only these postal areas)
+# --polygon=/path/to/polygon.csv  (keep only districts with at least one unit inside this E,N polygon)
+
+require 'optparse'
+require 'set'
+
+sliceAreas = nil
+slicePolygon = nil
+slicePolygonFile = nil
+
+OptionParser.new do |opts|
+  opts.banner = "Usage: gen-structs.rb [--areas=AA,BB,...] [--polygon=polygon.csv] /path/to/codepoint-open/folder"
+  opts.on('--areas=AREAS', Array, 'Keep only these postal areas') do |areas|
+    sliceAreas = (areas || []).map { |a| a.strip.upcase }.reject(&:empty?).uniq.sort
+  end
+  opts.on('--polygon=FILE', 'Keep only districts with units inside this polygon (one E,N vertex per line)') do |f|
+    slicePolygonFile = f
+    slicePolygon = []
+    File.open(f).each_line.with_index(1) do |l, lineNo|
+      l = l.strip
+      next if l.empty?
+      next if lineNo == 1 && l !~ /[0-9]/  # header, e.g. easting,northing
+      unless l =~ /\A(-?[0-9]+(\.[0-9]+)?)\s*,\s*(-?[0-9]+(\.[0-9]+)?)\z/
+        puts "Line #{lineNo} of polygon '#{f}' should be a numeric easting and northing, like 530000,180000"
+        exit 1
+      end
+      slicePolygon << [$1.to_f, $3.to_f]
+    end
+  end
+end.parse!
+
+if sliceAreas && slicePolygon
+  puts "Please specify either --areas or --polygon, not both"
+  exit 1
+end
+
+if sliceAreas && sliceAreas.empty?
+  puts "Please list at least one postal area after --areas="
+  exit 1
+end
+
+if slicePolygon && slicePolygon.count < 3
+  puts "Polygon in '#{slicePolygonFile}' needs at least 3 vertices"
+  exit 1
+end
+
 puts "Opening, reading and parsing postcode files ..."
 
 
@@ -48,6 +95,46 @@ outwardbboxes = File.exist?('outwardbboxes.csv') ?
 
 puts ">> WARNING: no bounding boxes. Location -> postcode lookups will be unreliable. <<" if outwardbboxes.nil?
 
+def pointInPolygon(e, n, polygon)  # ray casting: count edges crossed by a ray heading east from the point
+  inside = false
+  polygon.each_with_index do |(e1, n1), i|
+    e2, n2 = polygon[i - 1]
+    if (n1 > n) != (n2 > n) && e < (e2 - e1) * (n - n1) / (n2 - n1) + e1
+      inside = !inside
+    end
+  end
+  inside
+end
+
+# slices always keep whole districts, so that every retained outward code has all its inward codes,
+# and its bounding box (whether from outwardbboxes.csv or calculated below) is the same as in a full build
+
+sliceDescription = 'GB'
+droppedPcs = []
+
+if sliceAreas
+  unknownAreas = sliceAreas - pcs.map { |p| p[:area] }.uniq
+  unless unknownAreas.empty?
+    puts "No postcodes found in postal area(s) #{unknownAreas.join(', ')}"
+    exit 1
+  end
+
+  puts "Slicing to postal areas #{sliceAreas.join(', ')} ..."
+  droppedPcs, pcs = pcs.partition { |p| !sliceAreas.include?(p[:area]) }
+  sliceDescription = "areas #{sliceAreas.join(',')}"
+
+elsif slicePolygon
+  puts "Slicing to districts inside polygon #{slicePolygonFile} ..."
+  keptOutwards = pcs.select { |p| pointInPolygon(p[:e], p[:n], slicePolygon) }.map { |p| p[:area] + p[:district] }.to_set
+  droppedPcs, pcs = pcs.partition { |p| !keptOutwards.include?(p[:area] + p[:district]) }
+  sliceDescription = "polygon #{File.basename(slicePolygonFile)}"
+end
+
+if pcs.empty?
+  puts "No postcodes left after slicing"
+  exit 1
+end
+
 puts "Mapping symbols to save space ..."
 
 area0Mapping = pcs.map { |p| p[:area][0] || "\0" }.uniq.sort
@@ -90,8 +177,10 @@ end.sort_by { |p| p[0] }; nil
 # this can be checked like so: pcsByOutwardMapped.each_cons(2).all? { |a, b| a[0] < b[0] }
 
 inwardCodesOffset = 0
+sectorCodesOffset = 0
 outwardLookup = []
 inwardLookup = []
+sectorLookup = []
 
 pcsByOutwardMapped.each do |p|
   outwardCode, outwardCodeMapped, pcs = p
@@ -103,9 +192,28 @@ pcsByOutwardMapped.each do |p|
   else
     originE, originN, maxOffsetE, maxOffsetN = outwardbboxes[outwardCode]
   end
-  outwardLookup << [outwardCodeMapped, originE, originN, maxOffsetE, maxOffsetN, inwardCodesOffset]
+  centroidOffsetE = (pcs.sum { |pc| pc[:e] }.to_f / pcs.count).round - originE
+  centroidOffsetN = (pcs.sum { |pc| pc[:n] }.to_f / pcs.count).round - originN
+  outwardLookup << [outwardCodeMapped, originE, originN, maxOffsetE, maxOffsetN, inwardCodesOffset, sectorCodesOffset,
+                    centroidOffsetE, centroidOffsetN]
   inwardCodesOffset += pcs.count
 
+  # sector aggregates: a unit bbox relative to the outward origin, and a centroid relative to that bbox
+  sectorPcsMapped = pcs.group_by { |pc| pc[:sector] }.map do |sector, pcs|
+    sectorMapped = sectorMapping.index(sector)
+    es = pcs.map { |pc| pc[:e] }
+    ns = pcs.map { |pc| pc[:n] }
+    sectorOriginE, sectorOriginN = es.min, ns.min
+    centroidOffsetE = (es.sum.to_f / es.count).round - sectorOriginE
+    centroidOffsetN = (ns.sum.to_f / ns.count).round - sectorOriginN
+    sectorMeanCount = pcs.count { |pc| pc[:q] == '60' }
+    [sectorMapped, sectorOriginE - originE, sectorOriginN - originN, es.max - sectorOriginE, ns.max - sectorOriginN,
+     centroidOffsetE, centroidOffsetN, pcs.count, sectorMeanCount]
+  end.sort_by { |p| p[0] }
+  sectorCodesOffset += sectorPcsMapped.count
+
+  sectorLookup.concat sectorPcsMapped
+
   inwardPcsMapped = pcs.map do |pc| 
     sector = pc[:sector]
     unit = pc[:unit]  
@@ -124,10 +232,41 @@ pcsByOutwardMapped.each do |p|
   inwardLookup.concat inwardPcsMapped
 end; nil
 
+# dropped districts keep their bboxes (but no inward codes), so that reverse lookups can tell a location
+# outside the slice from one that's nowhere near any postcode; those whose bbox overlaps a retained one
+# also keep their units' locations as a 'halo', so a lookup near the edge of the slice can tell whether
+# the true nearest postcode is one we no longer have
+
+haloUnitsOffset = 0
+excludedLookup = []
+haloLookup = []
+
+droppedPcs.group_by { |p| p[:area] + p[:district] }.sort_by { |p| p[0] }.each do |outwardCode, pcs|
+  if outwardbboxes.nil?
+    originE = pcs.map { |pc| pc[:e]}.min
+    originN = pcs.map { |pc| pc[:n]}.min
+    maxOffsetE = pcs.map { |pc| pc[:e]}.max - originE
+    maxOffsetN = pcs.map { |pc| pc[:n]}.max - originN
+  else
+    originE, originN, maxOffsetE, maxOffsetN = outwardbboxes[outwardCode]
+  end
+  excludedLookup << [originE, originN, maxOffsetE, maxOffsetN, haloUnitsOffset]
+
+  overlapsRetained = outwardLookup.any? do |ol|
+    originE <= ol[1] + ol[3] && ol[1] <= originE + maxOffsetE &&
+    originN <= ol[2] + ol[4] && ol[2] <= originN + maxOffsetN
+  end
+  next unless overlapsRetained
+
+  haloUnitsOffset += pcs.count
+  haloLookup.concat pcs.map { |pc| [pc[:e] - originE, pc[:n] - originN] }
+end; nil
+excludedSentinel = [0, 0, 0, 0, haloUnitsOffset]  # ends the table, so every entry can find its halo units count
+
 puts "Generating C code ..."
 
 def bitsRequiredFor(maxValue)
-  Math.log2(maxValue + 1).ceil
+  [Math.log2(maxValue + 1).ceil, 1].max  # a named bitfield can't be zero-width, which small slices could otherwise need
 end
 
 typesC = "//
@@ -154,6 +293,9 @@ typedef struct {
   unsigned int maxOffsetE : #{bitsRequiredFor(outwardLookup.map { |ol| ol[3] }.max)};
   unsigned int maxOffsetN : #{bitsRequiredFor(outwardLookup.map { |ol| ol[4] }.max)};
   unsigned int inwardCodesOffset : #{bitsRequiredFor(outwardLookup.map { |ol| ol[5] }.max)};
+  unsigned int sectorCodesOffset : #{bitsRequiredFor(outwardLookup.map { |ol| ol[6] }.max)};
+  unsigned int centroidOffsetE : #{bitsRequiredFor(outwardLookup.map { |ol| ol[7] }.max)};
+  unsigned int centroidOffsetN : #{bitsRequiredFor(outwardLookup.map { |ol| ol[8] }.max)};
 } PACKED OutwardCode;
 
 typedef struct {
@@ -163,6 +305,31 @@ typedef struct {
   bool sectorMean : 1;
 } PACKED InwardCode;
 
+typedef struct {
+  unsigned int codeMapped : #{bitsRequiredFor(sectorLookup.map { |sl| sl[0] }.max)};
+  unsigned int originOffsetE : #{bitsRequiredFor(sectorLookup.map { |sl| sl[1] }.max)};
+  unsigned int originOffsetN : #{bitsRequiredFor(sectorLookup.map { |sl| sl[2] }.max)};
+  unsigned int maxOffsetE : #{bitsRequiredFor(sectorLookup.map { |sl| sl[3] }.max)};
+  unsigned int maxOffsetN : #{bitsRequiredFor(sectorLookup.map { |sl| sl[4] }.max)};
+  unsigned int centroidOffsetE : #{bitsRequiredFor(sectorLookup.map { |sl| sl[5] }.max)};
+  unsigned int centroidOffsetN : #{bitsRequiredFor(sectorLookup.map { |sl| sl[6] }.max)};
+  unsigned int unitCount : #{bitsRequiredFor(sectorLookup.map { |sl| sl[7] }.max)};
+  unsigned int sectorMeanCount : #{bitsRequiredFor(sectorLookup.map { |sl| sl[8] }.max)};
+} PACKED SectorCode;
+
+typedef struct {
+  unsigned int originE : #{bitsRequiredFor(excludedLookup.map { |el| el[0] }.push(0).max)};
+  unsigned int originN : #{bitsRequiredFor(excludedLookup.map { |el| el[1] }.push(0).max)};
+  unsigned int maxOffsetE : #{bitsRequiredFor(excludedLookup.map { |el| el[2] }.push(0).max)};
+  unsigned int maxOffsetN : #{bitsRequiredFor(excludedLookup.map { |el| el[3] }.push(0).max)};
+  unsigned int haloUnitsOffset : #{bitsRequiredFor(excludedSentinel[4])};
+} PACKED ExcludedOutwardCode;
+
+typedef struct {
+  unsigned int offsetE : #{bitsRequiredFor(haloLookup.map { |hl| hl[0] }.push(0).max)};
+  unsigned int offsetN : #{bitsRequiredFor(haloLookup.map { |hl| hl[1] }.push(0).max)};
+} PACKED HaloUnit;
+
 #endif
 "
 
@@ -185,6 +352,10 @@ dataC = "//
 static const char* dataSetVersionNumber = \"#{dataSetVersionNumber}\";
 static const char* dataSetCopyrightYear = \"#{copyrightYear}\";
 
+static const char* dataSetSlice = \"#{sliceDescription}\";
+static const bool dataSetIsSlice = #{sliceAreas || slicePolygon ? 'true' : 'false'};
+static const char* dataSetSliceAreas[] = { #{(sliceAreas || []).map { |a| "\"#{a}\"" }.push('NULL').join(',') } };
+
 static const char area0Mapping[] = { #{area0Mapping.map{ |m| "'#{m == "\u0000" ? '\0' : m}'" }.join(',') } };
 static const char area1Mapping[] = { #{area1Mapping.map{ |m| "'#{m == "\u0000" ? '\0' : m}'" }.join(',') } };
 static const char district0Mapping[] = { #{district0Mapping.map{ |m| "'#{m == "\u0000" ? '\0' : m}'" }.join(',') } };
@@ -200,6 +371,21 @@ static const OutwardCode outwardCodes[] = {
 static const InwardCode inwardCodes[] = {
 #{inwardLookup.map { |l| '{' + l.map(&:to_s).join(',') + '}' }.join(",\n")}
 };
+
+static const SectorCode sectorCodes[] = {
+#{sectorLookup.map { |l| '{' + l.map(&:to_s).join(',') + '}' }.join(",\n")}
+};
+
+// districts dropped from a slice (a full build has none), ended by a sentinel,
+// and the units of those dropped districts that overlap retained ones
+static const int excludedOutwardCodesCount = #{excludedLookup.count};
+static const ExcludedOutwardCode excludedOutwardCodes[] = {
+#{(excludedLookup + [excludedSentinel]).map { |l| '{' + l.map(&:to_s).join(',') + '}' }.join(",\n")}
+};
+
+static const HaloUnit haloUnits[] = {
+#{haloLookup.empty? ? '{0}' : haloLookup.map { |l| '{' + l.map(&:to_s).join(',') + '}' }.join(",\n")}
+};
 "
 
 puts "Writing C code ..."
@@ -40,7 +40,7 @@ int main(int argc, const char *argv[]) {
       bool found = outwardCodeFromPostcodeComponents(&oc, pcc);
 
       if (!found) {
-        puts("Outward postcode not found");
+        puts(postcodeComponentsInDataSlice(pcc) ? "Outward postcode not found" : "Outward postcode outside data slice");
         return EXIT_FAILURE;
       }
 
@@ -68,9 +68,46 @@ int main(int argc, const char *argv[]) {
       return EXIT_FAILURE;
     }
 
+    if (en.status == PostcodeOutOfCoverage) {
+      puts("Full postcode outside data slice");
+      return EXIT_FAILURE;
+    }
+
     printf("E %i  N %i%s\n", en.e, en.n, en.status == PostcodeSectorMeanOnly ? "  (sector mean)" : "");
     return EXIT_SUCCESS;
 
+  } else if (argc == 3 && (strcmp(argv[1], "sector") == 0 || strcmp(argv[1], "district") == 0)) {
+    // with 'sector' or 'district' and one more argument, look up aggregate figures
+    bool isSector = strcmp(argv[1], "sector") == 0;
+    PostcodeComponents pcc = isSector ?
+      postcodeComponentsFromSectorString(argv[2]) :
+      postcodeComponentsFromString(argv[2], true);
+
+    if (! pcc.valid) {
+      puts(isSector ? "Not a valid postcode sector" : "Not a valid postcode district");
+      return EXIT_FAILURE;
+    }
+
+    stringFromPostcodeComponents(pc, pcc);
+    puts(pc);
+
+    PostcodeAggregate pa = isSector ?
+      sectorAggregateFromPostcodeComponents(pcc) :
+      districtAggregateFromPostcodeComponents(pcc);
+
+    if (pa.status == PostcodeNotFound || pa.status == PostcodeOutOfCoverage) {
+      puts(pa.status == PostcodeNotFound ?
+           (isSector ? "Sector not found" : "District not found") :
+           (isSector ? "Sector outside data slice" : "District outside data slice"));
+      return EXIT_FAILURE;
+    }
+
+    printf("Centroid  E %i  N %i\n", pa.centroidE, pa.centroidN);
+    printf("Units E %i - %i  N %i - %i\n", pa.minE, pa.maxE, pa.minN, pa.maxN);
+    printf("%i units, %i (%.1f%%) sector mean only\n",
+           pa.unitCount, pa.sectorMeanCount, 100.0 * pa.sectorMeanCount / pa.unitCount);
+    return EXIT_SUCCESS;
+
   } else if (argc == 3) {
     // with two arguments, treat as a reverse lookup from E/N
     char *dummy;
@@ -81,7 +118,7 @@ int main(int argc, const char *argv[]) {
     NearbyPostcode np = nearbyPostcodeFromEastingNorthing(en);
 
     if (! np.components.valid) {
-      puts("No postcode near that location");
+      puts(np.en.status == PostcodeOutOfCoverage ? "Location outside data slice" : "No postcode near that location");
       return EXIT_FAILURE;
     }
 
@@ -99,11 +136,14 @@ int main(int argc, const char *argv[]) {
          "  postcodesc test  - run tests \n"
          "  postcodesc POSTCODE  - look up location from full/outward postcode (note: use quotes or omit spaces)\n"
          "  postcodesc EASTING NORTHING  - look up postcode from location\n"
+         "  postcodesc sector SECTOR  - look up centroid, extent and unit counts for a sector, e.g. 'BN1 5'\n"
+         "  postcodesc district OUTWARD  - look up centroid, extent and unit counts for a whole district\n"
          "\n"
          "Derived from Ordnance Survey CodePoint Open data\n"
          "Contains OS data (C) Crown copyright and database right 2019\n"
          "Contains Royal Mail data (C) Royal Mail copyright and database right 2019\n"
          "Contains National Statistics data (C) Crown copyright and database right 2019\n");
+    printf("CodePoint Open version %s, data slice: %s\n", codePointVersionNumber(), codePointDataSlice());
 
     return EXIT_FAILURE;
   }
@@ -6,6 +6,8 @@
 //  Copyright © 2019 George MacKerron. All rights reserved.
 //
 
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -102,6 +104,35 @@ static const PostcodeTestItem outwardOnlyTestItems[] = {
   {"BN222", false, "", {0}},
 };
 
+static const PostcodeTestItem sectorTestItems[] = {  // we only use status
+  {"bn1 5", true, "BN1 5", {0, 0, PostcodeOK}},
+  {" b n15 ", true, "BN1 5", {0, 0, PostcodeOK}},
+  {"sy21\t0", true, "SY21 0", {0, 0, PostcodeOK}},
+  {"\nwc2 a 2", true, "WC2A 2", {0, 0, PostcodeOK}},
+  {"xy1 1", true, "XY1 1", {0, 0, PostcodeNotFound}},
+  {"", false, "", {0}},
+  {"bn1", false, "", {0}},
+  {"bn1 a", false, "", {0}},
+  {"5", false, "", {0}},
+  {"bn1 5pq", false, "", {0}},
+  {"BN222 2", false, "", {0}},
+};
+
+typedef struct {
+  char input[16];
+  bool isSector;  // otherwise a district
+} AggregateTestItem;
+
+static const AggregateTestItem aggregateTestItems[] = {
+  // expected values come from looking up every possible unit in the sector or district one by one
+  {"BN1 5", true},
+  {"SY21 0", true},
+  {"E1W 1", true},  // includes sector means
+  {"BN1", false},
+  {"SY21", false},
+  {"EC1V", false},
+};
+
 static const PostcodeTestItem reverseLookupTestItems[] = {  // we only use formatted, easting and northing
   {"", true, "WC1A 2TA", {530300, 181600}},  // central London location in 16 outward bboxes
   {"", true, "BN1 9QQ", {534523, 109340}},  // University of Sussex
@@ -109,11 +140,15 @@ static const PostcodeTestItem reverseLookupTestItems[] = {  // we only use forma
   {"", true, "BN1 8YL", {524900, 109400}},  // rural Sussex, will fail with naive point bboxes
   {"", true, "BN41 2RF", {524200, 109400}},  // rural Sussex, will fail with naive point bboxes
   {"", true, "TR22 0PL", {86000, 7000}},  // Isles of Scilly, will fail with naive point bboxes
+  {"", true, "E1 0AA", {535267, 181084}},  // on E1 0AA, inside EC and other E bboxes: an EC-only slice must skip, not answer EC
+  {"", true, "EC1V 7JJ", {531760, 182831}},  // on EC1V 7JJ, inside E, N and WC bboxes: a slice keeping EC must still find it
   {"", true, "", {182000, 590000}},  // non-existent
 };
 
 int stringFromPostcodeTestItem(char s[54], PostcodeTestItem pti) {
-  if (pti.valid && pti.en.status != PostcodeNotFound) {
+  if (pti.valid && pti.en.status == PostcodeOutOfCoverage) {
+    return sprintf(s, "%s  (out of coverage)", pti.formatted);
+  } else if (pti.valid && pti.en.status != PostcodeNotFound) {
     // char s[54] allows for up to 11 digits for large negative E and N (plus \0 at end)
     return sprintf(s, "%s  E %i  N %i%s", pti.formatted, pti.en.e, pti.en.n, pti.en.status == PostcodeSectorMeanOnly ? "  (sector mean)" : "");
   } else if (pti.valid) {
@@ -123,22 +158,62 @@ int stringFromPostcodeTestItem(char s[54], PostcodeTestItem pti) {
   }
 }
 
+PostcodeAggregate aggregateByLookingUpEveryUnit(PostcodeComponents pcc, const bool isSector) {
+  PostcodeAggregate pa = {0};
+  pa.minE = pa.minN = UINT_MAX;
+  double sumE = 0, sumN = 0;
+  char firstSector = isSector ? pcc.sector : '0';
+  char lastSector = isSector ? pcc.sector : '9';
+
+  for (pcc.sector = firstSector; pcc.sector <= lastSector; pcc.sector ++) {
+    for (pcc.unit0 = 'A'; pcc.unit0 <= 'Z'; pcc.unit0 ++) {
+      for (pcc.unit1 = 'A'; pcc.unit1 <= 'Z'; pcc.unit1 ++) {
+        PostcodeEastingNorthing en = eastingNorthingFromPostcodeComponents(pcc);
+        if (en.status == PostcodeOutOfCoverage) pa.status = PostcodeOutOfCoverage;
+        if (en.status != PostcodeOK && en.status != PostcodeSectorMeanOnly) continue;
+        if (en.e < pa.minE) pa.minE = en.e;
+        if (en.n < pa.minN) pa.minN = en.n;
+        if (en.e > pa.maxE) pa.maxE = en.e;
+        if (en.n > pa.maxN) pa.maxN = en.n;
+        sumE += en.e;
+        sumN += en.n;
+        pa.unitCount ++;
+        if (en.status == PostcodeSectorMeanOnly) pa.sectorMeanCount ++;
+      }
+    }
+  }
+
+  if (pa.unitCount == 0) return (PostcodeAggregate){ .status = pa.status };
+  pa.centroidE = (unsigned int)round(sumE / pa.unitCount);
+  pa.centroidN = (unsigned int)round(sumN / pa.unitCount);
+  pa.status = pa.sectorMeanCount == pa.unitCount ? PostcodeSectorMeanOnly : PostcodeOK;
+  return pa;
+}
+
+int stringFromPostcodeAggregate(char s[128], PostcodeAggregate pa) {
+  if (pa.status == PostcodeNotFound) return sprintf(s, "(not found)");
+  return sprintf(s, "centroid E %i  N %i  units E %i - %i  N %i - %i  %i units (%i sector mean)%s",
+                 pa.centroidE, pa.centroidN, pa.minE, pa.maxE, pa.minN, pa.maxN,
+                 pa.unitCount, pa.sectorMeanCount, pa.status == PostcodeSectorMeanOnly ? "  (all sector mean)" : "");
+}
+
+bool skipOutOfCoverageTestItem(const PostcodeStatus status, const char *input, const bool noisily, short *numSkipped) {
+  // the expected results assume a full build, so anything outside a slice is skipped rather than tested
+  if (status != PostcodeOutOfCoverage) return false;
+  (*numSkipped) ++;
+  if (noisily) printf("Input:    '%s'\nSKIPPED (outside data slice)\n\n", input);
+  return true;
+}
+
 bool postcodeTest(const bool noisily) {
   short numTested = 0;
   short numPassed = 0;
+  short numSkipped = 0;
   char expectedStr[54];
   char actualStr[54];
   
   for (int i = 0, len = LENGTH_OF(postcodeTestItems); i < len; i ++) {
-    numTested ++;
     PostcodeTestItem expectedPti = postcodeTestItems[i];
-    stringFromPostcodeTestItem(expectedStr, expectedPti);
-    
-    if (noisily) {
-      printf("Input:    '%s'\n", expectedPti.input);
-      printf("Expected: %s\n", expectedStr);
-    }
-    
     PostcodeTestItem actualPti = {0};
     PostcodeComponents pcc = postcodeComponentsFromString(expectedPti.input, false);
     actualPti.valid = pcc.valid;
@@ -148,26 +223,24 @@ bool postcodeTest(const bool noisily) {
       actualPti.en = eastingNorthingFromPostcodeComponents(pcc);
     }
     
+    if (skipOutOfCoverageTestItem(actualPti.en.status, expectedPti.input, noisily, &numSkipped)) continue;
+    numTested ++;
+
+    stringFromPostcodeTestItem(expectedStr, expectedPti);
     stringFromPostcodeTestItem(actualStr, actualPti);
     bool testPassed = strcmp(expectedStr, actualStr) == 0;
     if (testPassed) numPassed ++;
     
     if (noisily) {
+      printf("Input:    '%s'\n", expectedPti.input);
+      printf("Expected: %s\n", expectedStr);
       printf("Actual:   %s\n", actualStr);
       printf("%s\n\n", testPassed ? "PASSED" : "FAILED");
     }
   }
   
   for (int i = 0, len = LENGTH_OF(outwardOnlyTestItems); i < len; i ++) {
-    numTested ++;
     PostcodeTestItem expectedPti = outwardOnlyTestItems[i];
-    stringFromPostcodeTestItem(expectedStr, expectedPti);
-    
-    if (noisily) {
-      printf("Input:    '%s'\n", expectedPti.input);
-      printf("Expected: %s\n", expectedStr);
-    }
-    
     PostcodeTestItem actualPti = {0};
     PostcodeComponents pcc = postcodeComponentsFromString(expectedPti.input, true);
     actualPti.valid = pcc.valid;
@@ -177,28 +250,129 @@ bool postcodeTest(const bool noisily) {
       OutwardCode oc = { 0 };
       bool ocFound = outwardCodeFromPostcodeComponents(&oc, pcc);
       actualPti.en = (PostcodeEastingNorthing){ .e = 0, .n = 0, .status = ocFound ? PostcodeOK : PostcodeNotFound };
+      if (! postcodeComponentsInDataSlice(pcc)) actualPti.en.status = PostcodeOutOfCoverage;
     }
     
+    if (skipOutOfCoverageTestItem(actualPti.en.status, expectedPti.input, noisily, &numSkipped)) continue;
+    numTested ++;
+
+    stringFromPostcodeTestItem(expectedStr, expectedPti);
     stringFromPostcodeTestItem(actualStr, actualPti);
     bool testPassed = strcmp(expectedStr, actualStr) == 0;
     if (testPassed) numPassed ++;
     
     if (noisily) {
+      printf("Input:    '%s'\n", expectedPti.input);
+      printf("Expected: %s\n", expectedStr);
       printf("Actual:   %s\n", actualStr);
       printf("%s\n\n", testPassed ? "PASSED" : "FAILED");
     }
   }
   
+  for (int i = 0, len = LENGTH_OF(sectorTestItems); i < len; i ++) {
+    PostcodeTestItem expectedPti = sectorTestItems[i];
+    PostcodeTestItem actualPti = {0};
+    PostcodeComponents pcc = postcodeComponentsFromSectorString(expectedPti.input);
+    actualPti.valid = pcc.valid;
+
+    if (actualPti.valid) {
+      stringFromPostcodeComponents(actualPti.formatted, pcc);
+      PostcodeAggregate pa = sectorAggregateFromPostcodeComponents(pcc);
+      actualPti.en = (PostcodeEastingNorthing){ .e = 0, .n = 0, .status = pa.status };
+    }
+
+    if (skipOutOfCoverageTestItem(actualPti.en.status, expectedPti.input, noisily, &numSkipped)) continue;
+    numTested ++;
+
+    stringFromPostcodeTestItem(expectedStr, expectedPti);
+    stringFromPostcodeTestItem(actualStr, actualPti);
+    bool testPassed = strcmp(expectedStr, actualStr) == 0;
+    if (testPassed) numPassed ++;
+
+    if (noisily) {
+      printf("Input:    '%s'\n", expectedPti.input);
+      printf("Expected: %s\n", expectedStr);
+      printf("Actual:   %s\n", actualStr);
+      printf("%s\n\n", testPassed ? "PASSED" : "FAILED");
+    }
+  }
+
+  for (int i = 0, len = LENGTH_OF(aggregateTestItems); i < len; i ++) {
+    AggregateTestItem ati = aggregateTestItems[i];
+    PostcodeComponents pcc = ati.isSector ?
+      postcodeComponentsFromSectorString(ati.input) :
+      postcodeComponentsFromString(ati.input, true);
+    PostcodeAggregate expectedPa = aggregateByLookingUpEveryUnit(pcc, ati.isSector);
+    PostcodeAggregate actualPa = ati.isSector ?
+      sectorAggregateFromPostcodeComponents(pcc) :
+      districtAggregateFromPostcodeComponents(pcc);
+
+    if (skipOutOfCoverageTestItem(actualPa.status, ati.input, noisily, &numSkipped)) continue;
+    numTested ++;
+
+    char expectedAggregateStr[128];
+    char actualAggregateStr[128];
+    stringFromPostcodeAggregate(expectedAggregateStr, expectedPa);
+    stringFromPostcodeAggregate(actualAggregateStr, actualPa);
+    bool testPassed = pcc.valid && expectedPa.unitCount > 0 && strcmp(expectedAggregateStr, actualAggregateStr) == 0;
+    if (testPassed) numPassed ++;
+
+    if (noisily) {
+      printf("Input:    '%s' (%s)\n", ati.input, ati.isSector ? "sector" : "district");
+      printf("Expected: %s\n", expectedAggregateStr);
+      printf("Actual:   %s\n", actualAggregateStr);
+      printf("%s\n\n", testPassed ? "PASSED" : "FAILED");
+    }
+  }
+
+  // the sector and district aggregates for any postcode we find must contain it and agree with each other
+  for (int i = 0, len = LENGTH_OF(postcodeTestItems); i < len; i ++) {
+    PostcodeTestItem pti = postcodeTestItems[i];
+    if (! pti.valid || pti.en.status == PostcodeNotFound) continue;
+
+    PostcodeComponents pcc = postcodeComponentsFromString(pti.input, false);
+    PostcodeEastingNorthing en = eastingNorthingFromPostcodeComponents(pcc);
+    if (en.status == PostcodeOutOfCoverage) continue;  // not counted as skipped: the forward lookup test above was
+
+    numTested ++;
+    pcc.unit0 = pcc.unit1 = '\0';
+    PostcodeAggregate spa = sectorAggregateFromPostcodeComponents(pcc);
+    PostcodeAggregate dpa = districtAggregateFromPostcodeComponents(pcc);
+
+    if (noisily) {
+      printf("Aggregates for: %s\n", pti.formatted);
+      printf("Sector:   E %i - %i  N %i - %i  %i units (%i sector mean)\n",
+             spa.minE, spa.maxE, spa.minN, spa.maxN, spa.unitCount, spa.sectorMeanCount);
+      printf("District: E %i - %i  N %i - %i  %i units (%i sector mean)\n",
+             dpa.minE, dpa.maxE, dpa.minN, dpa.maxN, dpa.unitCount, dpa.sectorMeanCount);
+    }
+
+    bool testPassed =
+      spa.status != PostcodeNotFound && dpa.status != PostcodeNotFound &&
+      en.e >= spa.minE && en.e <= spa.maxE && en.n >= spa.minN && en.n <= spa.maxN &&
+      spa.centroidE >= spa.minE && spa.centroidE <= spa.maxE && spa.centroidN >= spa.minN && spa.centroidN <= spa.maxN &&
+      spa.minE >= dpa.minE && spa.maxE <= dpa.maxE && spa.minN >= dpa.minN && spa.maxN <= dpa.maxN &&
+      dpa.centroidE >= dpa.minE && dpa.centroidE <= dpa.maxE && dpa.centroidN >= dpa.minN && dpa.centroidN <= dpa.maxN &&
+      spa.unitCount >= 1 && spa.unitCount <= dpa.unitCount &&
+      spa.sectorMeanCount <= spa.unitCount && spa.sectorMeanCount <= dpa.sectorMeanCount &&
+      (en.status != PostcodeSectorMeanOnly || spa.sectorMeanCount >= 1);
+    if (testPassed) numPassed ++;
+
+    if (noisily) printf("%s\n\n", testPassed ? "PASSED" : "FAILED");
+  }
+
   for (int i = 0, len = LENGTH_OF(reverseLookupTestItems); i < len; i++) {
-    numTested++;
     PostcodeTestItem expectedPti = reverseLookupTestItems[i];
+    NearbyPostcode np = nearbyPostcodeFromEastingNorthing(expectedPti.en);
+    sprintf(expectedStr, "E %i  N %i", expectedPti.en.e, expectedPti.en.n);
+    if (skipOutOfCoverageTestItem(np.en.status, expectedStr, noisily, &numSkipped)) continue;
+    numTested++;
 
     if (noisily) {
       printf("Input:    E %i  N %i \n", expectedPti.en.e, expectedPti.en.n);
       printf("Expected: %s\n", expectedPti.formatted);
     }
     
-    NearbyPostcode np = nearbyPostcodeFromEastingNorthing(expectedPti.en);
     stringFromPostcodeComponents(actualStr, np.components);
     bool testPassed = strcmp(expectedPti.formatted, actualStr) == 0;
     if (testPassed) numPassed ++;
@@ -210,8 +384,8 @@ bool postcodeTest(const bool noisily) {
   }
 
   bool allPassed = numTested == numPassed;
-  if (noisily) printf("%i tests; %i passed; %i failed\n\n",
-                      numTested, numPassed, numTested - numPassed);
+  if (noisily) printf("%i tests; %i passed; %i failed; %i skipped as outside data slice (%s)\n\n",
+                      numTested, numPassed, numTested - numPassed, numSkipped, codePointDataSlice());
   return allPassed;
 }
 
@@ -51,9 +51,10 @@
 DEFINE_INDEXOF(unsigned char, UnsignedChar)
 DEFINE_INDEXOFSTRUCT(OutwardCode, int, codeMapped)
 DEFINE_INDEXOFSTRUCT(InwardCode, int, codeMapped)
+DEFINE_INDEXOFSTRUCT(SectorCode, int, codeMapped)
 
 
-// forward lookup (postcode -> location)
+// mapping symbols and finding table entries
 
 int intByMappingChars(const int count, ...) {  // variadic args are (count) times: char c, int mappingLength, unsigned char* mapping
   va_list args;
@@ -76,14 +77,49 @@ int intByMappingChars(const int count, ...) {  // variadic args are (count) time
   return result;
 }
 
-bool outwardCodeFromPostcodeComponents(OutwardCode *oc, const PostcodeComponents pcc) {
+int outwardCodeIndexFromPostcodeComponents(const PostcodeComponents pcc) {
   int outwardCodeMapped = intByMappingChars(4,
                                             pcc.district1, LENGTH_OF(district1Mapping), district1Mapping,
                                             pcc.district0, LENGTH_OF(district0Mapping), district0Mapping,
                                             pcc.area1, LENGTH_OF(area1Mapping), area1Mapping,
                                             pcc.area0, LENGTH_OF(area0Mapping), area0Mapping);
-  if (outwardCodeMapped == -1) return false;
-  int ocIndex = indexOfOutwardCode(outwardCodeMapped, outwardCodes, LENGTH_OF(outwardCodes));
+  if (outwardCodeMapped == -1) return -1;
+  return indexOfOutwardCode(outwardCodeMapped, outwardCodes, LENGTH_OF(outwardCodes));
+}
+
+int inwardCodesCountForOutwardCodeIndex(const int ocIndex) {
+  return (ocIndex < LENGTH_OF(outwardCodes) - 1 ?
+          outwardCodes[ocIndex + 1].inwardCodesOffset :
+          LENGTH_OF(inwardCodes)) - outwardCodes[ocIndex].inwardCodesOffset;
+}
+
+int sectorCodesCountForOutwardCodeIndex(const int ocIndex) {
+  return (ocIndex < LENGTH_OF(outwardCodes) - 1 ?
+          outwardCodes[ocIndex + 1].sectorCodesOffset :
+          LENGTH_OF(sectorCodes)) - outwardCodes[ocIndex].sectorCodesOffset;
+}
+
+int haloUnitsCountForExcludedIndex(const int xcIndex) {
+  // excludedOutwardCodes ends with a sentinel entry, so there's always a next offset
+  return excludedOutwardCodes[xcIndex + 1].haloUnitsOffset - excludedOutwardCodes[xcIndex].haloUnitsOffset;
+}
+
+
+// forward lookup (postcode -> location)
+
+bool postcodeComponentsInDataSlice(const PostcodeComponents pcc) {
+  // a full build covers everything; an area slice covers its whole areas, whether or not a district exists;
+  // a polygon slice covers only the districts it contains
+  if (! dataSetIsSlice) return true;
+  for (int i = 0; dataSetSliceAreas[i] != NULL; i ++) {
+    const char *area = dataSetSliceAreas[i];
+    if (area[0] == pcc.area0 && area[1] == pcc.area1) return true;  // area[1] is '\0' for one-letter areas, as is pcc.area1
+  }
+  return outwardCodeIndexFromPostcodeComponents(pcc) != -1;
+}
+
+bool outwardCodeFromPostcodeComponents(OutwardCode *oc, const PostcodeComponents pcc) {
+  int ocIndex = outwardCodeIndexFromPostcodeComponents(pcc);
   if (ocIndex == -1) return false;
   *oc = outwardCodes[ocIndex];
   return true;
@@ -91,14 +127,11 @@ bool outwardCodeFromPostcodeComponents(OutwardCode *oc, const PostcodeComponents
 
 PostcodeEastingNorthing eastingNorthingFromPostcodeComponents(const PostcodeComponents pcc) {
   PostcodeEastingNorthing en = (PostcodeEastingNorthing){0};
-  int outwardCodeMapped = intByMappingChars(4,
-                                            pcc.district1, LENGTH_OF(district1Mapping), district1Mapping,
-                                            pcc.district0, LENGTH_OF(district0Mapping), district0Mapping,
-                                            pcc.area1, LENGTH_OF(area1Mapping), area1Mapping,
-                                            pcc.area0, LENGTH_OF(area0Mapping), area0Mapping);
-  if (outwardCodeMapped == -1) return en;
-  int ocIndex = indexOfOutwardCode(outwardCodeMapped, outwardCodes, LENGTH_OF(outwardCodes));
-  if (ocIndex == -1) return en;
+  int ocIndex = outwardCodeIndexFromPostcodeComponents(pcc);
+  if (ocIndex == -1) {
+    if (! postcodeComponentsInDataSlice(pcc)) en.status = PostcodeOutOfCoverage;
+    return en;
+  }
   OutwardCode oc = outwardCodes[ocIndex];
   
   int inwardCodeMapped = intByMappingChars(3,
@@ -106,10 +139,7 @@ PostcodeEastingNorthing eastingNorthingFromPostcodeComponents(const PostcodeComp
                                            pcc.unit0, LENGTH_OF(unit0Mapping), unit0Mapping,
                                            pcc.sector, LENGTH_OF(sectorMapping), sectorMapping);
   if (inwardCodeMapped == -1) return en;
-  int inwardCodesCount = (ocIndex < LENGTH_OF(outwardCodes) - 1 ?
-                          outwardCodes[ocIndex + 1].inwardCodesOffset :
-                          LENGTH_OF(inwardCodes)) - oc.inwardCodesOffset;
-  int icIndex = indexOfInwardCode(inwardCodeMapped, &inwardCodes[oc.inwardCodesOffset], inwardCodesCount);
+  int icIndex = indexOfInwardCode(inwardCodeMapped, &inwardCodes[oc.inwardCodesOffset], inwardCodesCountForOutwardCodeIndex(ocIndex));
   if (icIndex == -1) return en;
   InwardCode ic = inwardCodes[oc.inwardCodesOffset + icIndex];
   
@@ -160,9 +190,7 @@ NearbyPostcode nearbyPostcodeFromEastingNorthing(const PostcodeEastingNorthing e
     int offsetE = en.e - oc.originE;
     int offsetN = en.n - oc.originN;
 
-    int nextInwardCodesOffset = ocIndex < ocLen - 1 ? 
-      outwardCodes[ocIndex + 1].inwardCodesOffset : 
-      LENGTH_OF(inwardCodes);
+    int nextInwardCodesOffset = oc.inwardCodesOffset + inwardCodesCountForOutwardCodeIndex(ocIndex);
 
     /*
     PostcodeComponents pcc = {0};
@@ -189,6 +217,32 @@ NearbyPostcode nearbyPostcodeFromEastingNorthing(const PostcodeEastingNorthing e
     }
   }
   
+  // a location inside a dropped district's bbox is outside the slice if we found nothing, or if one of
+  // that district's units is nearer than the best we found (in a full build, there are no dropped districts)
+  for (int xcIndex = 0; xcIndex < excludedOutwardCodesCount; xcIndex ++) {
+    ExcludedOutwardCode xc = excludedOutwardCodes[xcIndex];
+    if (en.e < xc.originE ||
+        en.n < xc.originN ||
+        en.e > xc.originE + xc.maxOffsetE ||
+        en.n > xc.originN + xc.maxOffsetN) continue;
+
+    bool outOfCoverage = minDSqOutwardIndex == -1;
+    int offsetE = en.e - xc.originE;
+    int offsetN = en.n - xc.originN;
+    for (int huIndex = xc.haloUnitsOffset, huEnd = huIndex + haloUnitsCountForExcludedIndex(xcIndex);
+         huIndex < huEnd && ! outOfCoverage; huIndex ++) {
+      HaloUnit hu = haloUnits[huIndex];
+      long deltaE = offsetE - (int)hu.offsetE;
+      long deltaN = offsetN - (int)hu.offsetN;
+      outOfCoverage = deltaE * deltaE + deltaN * deltaN < minDSq;
+    }
+
+    if (outOfCoverage) {
+      np.en.status = PostcodeOutOfCoverage;
+      return np;
+    }
+  }
+
   if (minDSqOutwardIndex == -1) return np;
 
   OutwardCode oc = outwardCodes[minDSqOutwardIndex];
@@ -215,6 +269,67 @@ NearbyPostcode nearbyPostcodeFromEastingNorthing(const PostcodeEastingNorthing e
   return np;
 }
 
+// sector and district aggregates
+
+PostcodeAggregate sectorAggregateFromPostcodeComponents(const PostcodeComponents pcc) {
+  PostcodeAggregate pa = (PostcodeAggregate){0};
+  int ocIndex = outwardCodeIndexFromPostcodeComponents(pcc);
+  if (ocIndex == -1) {
+    if (! postcodeComponentsInDataSlice(pcc)) pa.status = PostcodeOutOfCoverage;
+    return pa;
+  }
+  OutwardCode oc = outwardCodes[ocIndex];
+
+  int sectorMapped = indexOfUnsignedChar(pcc.sector, (const unsigned char *)sectorMapping, LENGTH_OF(sectorMapping));
+  if (sectorMapped == -1) return pa;
+  int scIndex = indexOfSectorCode(sectorMapped, &sectorCodes[oc.sectorCodesOffset], sectorCodesCountForOutwardCodeIndex(ocIndex));
+  if (scIndex == -1) return pa;
+  SectorCode sc = sectorCodes[oc.sectorCodesOffset + scIndex];
+
+  pa.minE = oc.originE + sc.originOffsetE;
+  pa.minN = oc.originN + sc.originOffsetN;
+  pa.maxE = pa.minE + sc.maxOffsetE;
+  pa.maxN = pa.minN + sc.maxOffsetN;
+  pa.centroidE = pa.minE + sc.centroidOffsetE;
+  pa.centroidN = pa.minN + sc.centroidOffsetN;
+  pa.unitCount = sc.unitCount;
+  pa.sectorMeanCount = sc.sectorMeanCount;
+  pa.status = sc.sectorMeanCount == sc.unitCount ? PostcodeSectorMeanOnly : PostcodeOK;
+
+  return pa;
+}
+
+PostcodeAggregate districtAggregateFromPostcodeComponents(const PostcodeComponents pcc) {
+  // a district has at most 10 sectors, so we combine their aggregates rather than storing a district table too
+  // (except for the centroid, which is stored on the outward code so that it isn't built from rounded sector centroids)
+  PostcodeAggregate pa = (PostcodeAggregate){0};
+  int ocIndex = outwardCodeIndexFromPostcodeComponents(pcc);
+  if (ocIndex == -1) {
+    if (! postcodeComponentsInDataSlice(pcc)) pa.status = PostcodeOutOfCoverage;
+    return pa;
+  }
+  OutwardCode oc = outwardCodes[ocIndex];
+
+  pa.minE = pa.minN = UINT_MAX;
+  for (int scIndex = oc.sectorCodesOffset, scEnd = scIndex + sectorCodesCountForOutwardCodeIndex(ocIndex); scIndex < scEnd; scIndex ++) {
+    SectorCode sc = sectorCodes[scIndex];
+    unsigned int minE = oc.originE + sc.originOffsetE;
+    unsigned int minN = oc.originN + sc.originOffsetN;
+    if (minE < pa.minE) pa.minE = minE;
+    if (minN < pa.minN) pa.minN = minN;
+    if (minE + sc.maxOffsetE > pa.maxE) pa.maxE = minE + sc.maxOffsetE;
+    if (minN + sc.maxOffsetN > pa.maxN) pa.maxN = minN + sc.maxOffsetN;
+    pa.unitCount += sc.unitCount;
+    pa.sectorMeanCount += sc.sectorMeanCount;
+  }
+
+  pa.centroidE = oc.originE + oc.centroidOffsetE;
+  pa.centroidN = oc.originN + oc.centroidOffsetN;
+  pa.status = pa.sectorMeanCount == pa.unitCount ? PostcodeSectorMeanOnly : PostcodeOK;
+
+  return pa;
+}
+
 // parsing and formatting
 
 PostcodeComponents postcodeComponentsFromString(const char s[], bool outwardOnly) {
@@ -280,6 +395,30 @@ PostcodeComponents postcodeComponentsFromString(const char s[], bool outwardOnly
   return pcc;
 }
 
+PostcodeComponents postcodeComponentsFromSectorString(const char s[]) {
+  // a sector is an outward code plus a sector digit, e.g. BN1 5
+  PostcodeComponents pcc = (PostcodeComponents){0};
+  char outward[16];
+  int lenOutward = 0;
+  char sector = '\0';
+  char c;
+
+  for (int i = 0; (c = s[i]) != '\0'; i ++) {
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;  // ignore whitespace
+    if (sector != '\0') {  // the previous last character turns out to belong to the outward code
+      if (lenOutward > LENGTH_OF(outward) - 2) return pcc;  // too long
+      outward[lenOutward++] = sector;
+    }
+    sector = c;
+  }
+  if (sector < '0' || sector > '9') return pcc;  // sector is 0-9
+  outward[lenOutward] = '\0';
+
+  pcc = postcodeComponentsFromString(outward, true);
+  if (pcc.valid) pcc.sector = sector;
+  return pcc;
+}
+
 int stringFromPostcodeComponents(char s[9], const PostcodeComponents pcc) {
   char area1str[] = { pcc.area1, '\0' };  // if area1 is null, this is a zero-length string, as desired
   char district1str[] = { pcc.district1, '\0' };  // ditto for district1
@@ -296,3 +435,7 @@ const char* codePointVersionNumber(void) {
 const char* codePointCopyrightYear(void) {
   return dataSetCopyrightYear;
 }
+
+const char* codePointDataSlice(void) {
+  return dataSetSlice;
+}
@@ -15,7 +15,8 @@
 typedef enum {
   PostcodeNotFound = 0,
   PostcodeSectorMeanOnly = 1,
-  PostcodeOK = 2
+  PostcodeOK = 2,
+  PostcodeOutOfCoverage = 3  // outside the slice of data this library was built with (see gen-structs.rb)
 } PostcodeStatus;
 
 typedef struct {
@@ -35,20 +36,37 @@ typedef struct {
   PostcodeStatus status;
 } PostcodeEastingNorthing;
 
+typedef struct {
+  unsigned int centroidE;
+  unsigned int centroidN;
+  unsigned int minE;
+  unsigned int minN;
+  unsigned int maxE;
+  unsigned int maxN;
+  unsigned int unitCount;
+  unsigned int sectorMeanCount;
+  PostcodeStatus status;  // PostcodeSectorMeanOnly here means that *every* unit in the sector or district is a sector mean
+} PostcodeAggregate;  // summary of all units in a sector or district
+
 typedef struct {
   PostcodeComponents components;
   PostcodeEastingNorthing en;
   double distance;
 } NearbyPostcode;
 
+bool postcodeComponentsInDataSlice(const PostcodeComponents pcc);
 bool outwardCodeFromPostcodeComponents(OutwardCode *oc, const PostcodeComponents pcc);
 PostcodeEastingNorthing eastingNorthingFromPostcodeComponents(const PostcodeComponents pcc);
 NearbyPostcode nearbyPostcodeFromEastingNorthing(const PostcodeEastingNorthing en);
+PostcodeAggregate sectorAggregateFromPostcodeComponents(const PostcodeComponents pcc);
+PostcodeAggregate districtAggregateFromPostcodeComponents(const PostcodeComponents pcc);
 
 PostcodeComponents postcodeComponentsFromString(const char s[], bool outwardOnly);
+PostcodeComponents postcodeComponentsFromSectorString(const char s[]);
 int stringFromPostcodeComponents(char s[9], const PostcodeComponents pcc);
 
 const char* codePointVersionNumber(void);
 const char* codePointCopyrightYear(void);
+const char* codePointDataSlice(void);
 
 #endif /* postcodes_h */